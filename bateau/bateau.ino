@@ -18,6 +18,9 @@
 #include "radioMessage.h"
 #include "pontH.h"
 #include "reboot.h"
+#include "console.h"
+#include "memoire.h"
+#include "lissage.h"
 
 // **Définition des broches utilisées**
 #define moteurGauchePWM       6
@@ -28,14 +31,20 @@
 #define CE_PIN 7
 #define CSN_PIN 8
 
+// **Délai d'inactivité radio en millisecondes avant l'arrêt des moteurs**
+#define DELAI_ARRET 100
+
 // **Variable pour stocker le timestamp**
 unsigned long time = 0;
 
 // **Objet pour la communication radio**
 RF24    radio(CE_PIN, CSN_PIN); // instantiate an object for the nRF24L01 transceiver
 
-// **Structure pour contenir le message radio**
+// **Structure pour contenir le message radio et sa trame codée**
 radioMessage msg;
+radioTrame   trame;
+
+static_assert(PONTH_VITESSE_MAX == RADIO_VITESSE_MAX, "Le pont en H doit accepter la résolution des vitesses transmises");
 
 // **Objet pour piloter les moteurs**
 pontH    pont(moteurGauchePWM, moteurGaucheDirection, moteurDroitPWM, moteurDroitDirection);
@@ -47,6 +56,30 @@ uint8_t address[][6] = { "1NODE", "2NODE" };
 // **Niveau de puissance de la radio**
 uint8_t radioPowerLevel = RF24_PA_LOW;
 
+// **Compteurs de diagnostic**
+uint32_t compteurRecus     = 0; // Messages valides reçus
+uint32_t compteurInvalides = 0; // Messages invalides reçus
+uint32_t compteurArrets    = 0; // Arrêts des moteurs sur perte de la liaison radio
+bool     moteursArretes    = true;
+
+// **Tampon de gigue optionnel entre la réception radio et le pont en H**
+lisseur  lissage(DELAI_ARRET);
+bool     lissageActif      = false;
+
+// **Mesure du délai entre la réception d'un message et l'application de sa commande aux moteurs**
+bool          mesureEnCours   = false; // Un message reçu n'a pas encore été appliqué
+uint8_t       mesureJeton     = 0;     // Jeton de latence du message mesuré (0 = aucun)
+unsigned long mesureReception = 0;     // Instant de réception du message mesuré en microsecondes
+unsigned long mesureInstant   = 0;     // Instant de réception du message mesuré en millisecondes
+uint32_t      delaiCumul      = 0;     // Somme des délais mesurés en microsecondes
+uint16_t      delaiNombre     = 0;     // Nombre de délais mesurés
+uint32_t      delaiMax        = 0;     // Plus grand délai mesuré en microsecondes
+
+#ifdef BATEAU_DEBUG
+// **Console de commandes série pour le diagnostic**
+console terminal;
+#endif
+
 
 
 /**
@@ -76,7 +109,11 @@ void setup()
 
   // save on transmission time by setting the radio to only transmit the
   // number of bytes we need to transmit a float
-  radio.setPayloadSize(sizeof(msg));  // float datatype occupies 4 bytes
+  radio.setPayloadSize(sizeof(trame));  // la trame codée occupe TRAME_TAILLE octets
+
+  // Les échos de la sonde de latence sont renvoyés à la télécommande dans la charge utile des acquittements
+  radio.enableDynamicPayloads();
+  radio.enableAckPayload();
 
   // set the TX address of the RX node into the TX pipe
   radio.openWritingPipe(address[1]);  // always uses pipe 0
@@ -86,6 +123,10 @@ void setup()
 
   radio.startListening();               // Démarrer l'écoute radio
 
+#ifdef BATEAU_DEBUG
+  afficherMemoire();
+#endif
+
 }
 
 /**
@@ -100,16 +141,37 @@ void loop()
   if (radio.available(&pipe)) // Vérifier si un message est disponible
   {
     //Serial.println("B");
-    uint8_t bytes = radio.getPayloadSize(); // Obtenir
-    radio.read(&msg, bytes);                 // Lire le message radio
+    unsigned long reception = micros();
+    uint8_t bytes = radio.getDynamicPayloadSize(); // Obtenir la taille du message
+    radio.read(&trame, bytes < sizeof(trame) ? bytes : sizeof(trame)); // Lire la trame radio
 
     //Serial.println("C");
-    //Serial.print(*reinterpret_cast<uint32_t*>(&msg), HEX);
-    if(messageIsValid(msg))// Vérifier la validité du message
+    if(bytes == sizeof(trame) && decoder(trame, msg))// Vérifier la validité de la trame et la décoder
     {
       // Mettre à jour le timestamp
       time = millis();
-      pont.vitesseMoteurs(msg.gauche, msg.droit); // Piloter les moteurs en fonction des vitesses reçues
+      ++compteurRecus;
+      moteursArretes = false;
+
+      // Un message portant un jeton remplace la mesure en cours, les autres attendent qu'elle se termine
+      if(!mesureEnCours || msg.jeton)
+      {
+        mesureEnCours = true;
+        mesureJeton = msg.jeton;
+        mesureReception = reception;
+        mesureInstant = time;
+      }
+
+      if(lissageActif)
+      {
+        // Les moteurs sont pilotés plus bas, avec le retard de rejeu du tampon de gigue
+        lissage.pousser(msg.gauche, msg.droit, time);
+      }
+      else
+      {
+        pont.vitesseMoteurs(msg.gauche, msg.droit); // Piloter les moteurs en fonction des vitesses reçues
+        messageApplique();
+      }
       controleBateau(msg.cmd);
     }
     else
@@ -123,11 +185,38 @@ void loop()
   }
 
 
-  // Arréter les moteurs après 100ms d'inactivité radio
-  if(millis() > time+100)
+  // Piloter les moteurs avec la commande lissée lorsqu'elle change
+  if(lissageActif && !moteursArretes)
   {
+    int16_t gauche, droit;
+    unsigned long maintenant = millis();
+    if(lissage.commande(maintenant, gauche, droit)) pont.vitesseMoteurs(gauche, droit);
+
+    // Le message mesuré est appliqué lorsque l'instant de rejeu l'atteint
+    if(mesureEnCours && lissage.rejoue(mesureInstant, maintenant)) messageApplique();
+  }
+
+  // Arréter les moteurs après DELAI_ARRET ms d'inactivité radio
+  if(millis() > time+DELAI_ARRET)
+  {
+    if(!moteursArretes)
+    {
+      ++compteurArrets;
+      moteursArretes = true;
+      mesureEnCours = false;
+      lissage.vider();
+    }
     pont.stopMoteurs();
   }
+
+#ifdef BATEAU_DEBUG
+  // Traiter au plus une commande de la console sans bloquer la boucle
+  if(terminal.poll())
+  {
+    traiterCommande();
+    terminal.effacer();
+  }
+#endif
   //delay(50);
 }
 
@@ -135,25 +224,66 @@ void loop()
  * @brief Fonction pour contréler le bateau en fonction de la commande reçue
  * @param cmd La commande reçue de la télécommande
  */
-void controleBateau(char cmd)
+void controleBateau(uint8_t cmd)
 {
-  // Gérer la commande de redémarrage
-  if(cmd & radioCmd::RESET) reboot();
-
-  // Gérer la commande de changement de puissance radio
-  if(cmd & 0b111)
+  switch(cmd)
   {
-    radioPowerLevel = (cmd & radioCmd::PA_MIN) ? RF24_PA_MIN  : radioPowerLevel;
-    radioPowerLevel = (cmd & radioCmd::PA_LOW) ? RF24_PA_LOW  : radioPowerLevel;
-    radioPowerLevel = (cmd & radioCmd::PA_HI ) ? RF24_PA_HIGH : radioPowerLevel;
-    radioPowerLevel = (cmd & radioCmd::PA_MAX) ? RF24_PA_MAX  : radioPowerLevel;
-    radio.setPALevel(radioPowerLevel);
+    // Gérer la commande de redémarrage
+    case radioCmd::RESET:  reboot(); break;
+
+    // Gérer la commande de changement de puissance radio
+    case radioCmd::PA_MIN: radioPowerLevel = RF24_PA_MIN;  break;
+    case radioCmd::PA_LOW: radioPowerLevel = RF24_PA_LOW;  break;
+    case radioCmd::PA_HI:  radioPowerLevel = RF24_PA_HIGH; break;
+    case radioCmd::PA_MAX: radioPowerLevel = RF24_PA_MAX;  break;
+    default: return;
+  }
+
+  radio.setPALevel(radioPowerLevel);
 
 #ifdef BATEAU_DEBUG
-    Serial.print(F("RF24_PA change"));
-    Serial.println(radioPowerLevel);
+  Serial.print(F("RF24_PA change"));
+  Serial.println(radioPowerLevel);
 #endif
+}
+
+/**
+ * @brief Fonction pour terminer la mesure du délai d'application du message en cours de mesure
+ *
+ * Elle doit être appelée lorsque la commande du message mesuré vient d'être appliquée aux moteurs. Le délai
+ * est ajouté aux statistiques, et renvoyé à la télécommande si le message portait un jeton de latence.
+ */
+void messageApplique()
+{
+  uint32_t delai = micros() - mesureReception;
+  mesureEnCours = false;
+
+  if(delaiNombre < UINT16_MAX)
+  {
+    delaiCumul += delai;
+    ++delaiNombre;
+    delaiMax = delai > delaiMax ? delai : delaiMax;
   }
+
+  if(mesureJeton) renvoyerEcho(mesureJeton, delai);
+}
+
+/**
+ * @brief Fonction pour renvoyer le jeton de latence à la télécommande
+ *
+ * L'écho est placé dans la charge utile du prochain acquittement. Les échos précédents non encore
+ * transmis sont abandonnés pour que l'écho ne soit pas retardé derrière eux.
+ * @param jeton Le jeton reçu de la télécommande
+ * @param delai Délai en microsecondes entre la réception du message et l'application des PWM
+ */
+void renvoyerEcho(uint8_t jeton, uint32_t delai)
+{
+  radioEcho echo;
+  echo.jeton = jeton;
+  echo.delai = delai;
+
+  radio.flush_tx();
+  radio.writeAckPayload(1, &echo, sizeof(echo));
 }
 
 /**
@@ -161,9 +291,107 @@ void controleBateau(char cmd)
  */
 void messageInvalid()
 {
+  ++compteurInvalides;
 #ifdef BATEAU_DEBUG
-  Serial.println("Reception d'un message invalid");
-  Serial.print(*reinterpret_cast<uint32_t*>(&msg), HEX);
+  Serial.println(F("Reception d'un message invalid"));
+  for(uint8_t i = 0; i < sizeof(trame); ++i)
+  {
+    Serial.print(trame.octets[i], HEX);
+    Serial.print(' ');
+  }
   Serial.println();
 #endif
-}
\ No newline at end of file
+}
+
+#ifdef BATEAU_DEBUG
+/**
+ * @brief Fonction pour exécuter la commande reçue sur la console série
+ *
+ * Commandes disponibles :
+ * - `STAT`     : affiche les compteurs de réception radio
+ * - `PARAM`    : affiche la puissance radio et les paramètres du pont en H
+ * - `PA n`     : change la puissance radio (0 = min, 1 = low, 2 = high, 3 = max)
+ * - `REGIME n` : change le régime minimum des moteurs (0 à 255)
+ * - `BOOST n`  : change le délai d'overboost des moteurs en millisecondes
+ * - `MEM`      : affiche la mémoire vive libre actuelle et minimale
+ * - `LISSAGE n`: affiche le délai d'application mesuré depuis le dernier affichage, puis active (1) ou désactive (0)
+ *                le tampon de gigue et affiche ses paramètres. Le délai est mesuré avec et sans tampon.
+ *                Le tampon n'a d'effet que si la télécommande envoie plus souvent que DELAI_ARRET : à la période
+ *                par défaut de 200 ms, l'arrêt d'urgence le vide entre deux messages (régler PERIODE sur la télécommande).
+ * - `RETARD n` : change le retard de rejeu du tampon de gigue en millisecondes
+ * - `MAINTIEN n`: change la durée de prolongation de la dernière commande en millisecondes
+ */
+void traiterCommande()
+{
+  if(terminal.commande(PSTR("STAT")))
+  {
+    Serial.print(F("Recus = "));
+    Serial.print(compteurRecus);
+    Serial.print(F(" Invalides = "));
+    Serial.print(compteurInvalides);
+    Serial.print(F(" Arrets = "));
+    Serial.print(compteurArrets);
+    Serial.print(F(" Boutons = "));
+    Serial.println(msg.boutons, HEX);
+  }
+  else if(terminal.commande(PSTR("PARAM")))
+  {
+    Serial.print(F("RF24_PA = "));
+    Serial.println(radioPowerLevel);
+    Serial.print(F("Regime minimum = "));
+    Serial.println(pont.getRegimeMinimum());
+    Serial.print(F("Overboost = "));
+    Serial.println(pont.getOverBoostDelay());
+  }
+  else if(terminal.commande(PSTR("PA")))
+  {
+    radioPowerLevel = constrain(terminal.argumentEntier(radioPowerLevel), RF24_PA_MIN, RF24_PA_MAX);
+    radio.setPALevel(radioPowerLevel);
+    Serial.print(F("RF24_PA change"));
+    Serial.println(radioPowerLevel);
+  }
+  else if(terminal.commande(PSTR("REGIME")))
+  {
+    pont.setRegimeMinimum(constrain(terminal.argumentEntier(pont.getRegimeMinimum()), 0, 255));
+  }
+  else if(terminal.commande(PSTR("BOOST")))
+  {
+    pont.setOverBoostDelay(constrain(terminal.argumentEntier(pont.getOverBoostDelay()), 0, 255));
+  }
+  else if(terminal.commande(PSTR("MEM")))
+  {
+    afficherMemoire();
+  }
+  else if(terminal.commande(PSTR("LISSAGE")))
+  {
+    Serial.print(F("Delai moyen = "));
+    Serial.print(delaiNombre ? delaiCumul / delaiNombre : 0);
+    Serial.print(F(" Delai max = "));
+    Serial.print(delaiMax);
+    Serial.print(F(" us Lissage = "));
+    Serial.println(lissageActif);
+    delaiCumul = 0;
+    delaiNombre = 0;
+    delaiMax = 0;
+
+    lissageActif = terminal.argumentEntier(lissageActif);
+    lissage.vider();
+    mesureEnCours = false;
+    Serial.print(F("Lissage = "));
+    Serial.println(lissageActif);
+    lissage.afficher();
+  }
+  else if(terminal.commande(PSTR("RETARD")))
+  {
+    lissage.setRetard(constrain(terminal.argumentEntier(lissage.getRetard()), 0, DELAI_ARRET));
+  }
+  else if(terminal.commande(PSTR("MAINTIEN")))
+  {
+    lissage.setMaintien(constrain(terminal.argumentEntier(lissage.getMaintien()), 0, DELAI_ARRET));
+  }
+  else
+  {
+    Serial.println(F("Commandes : STAT PARAM PA n REGIME n BOOST n MEM LISSAGE n RETARD n MAINTIEN n"));
+  }
+}
+#endif
@@ -0,0 +1,274 @@
+/**
+ * @file lissage.h
+ * @author Florent LERAY, Jérémy Lefort Besnard
+ * @date 2024-03-06
+ * @brief Définit la classe `lisseur`, un tampon de gigue qui lisse les commandes reçues avant le pont en H.
+ *
+ * Les commandes reçues sont horodatées et conservées dans un petit tampon circulaire. Elles sont rejouées
+ * avec un retard configurable, ce qui permet d'interpoler entre deux messages et d'absorber la gigue de la
+ * liaison radio. Lorsqu'aucun message récent n'est disponible, la dernière commande est prolongée pendant
+ * une durée de maintien, puis décroît linéairement jusqu'à zéro avant l'arrêt d'urgence du bateau.
+ *
+ * Le tampon n'est utile que si les messages arrivent plus souvent que le délai d'arrêt d'urgence : sinon
+ * il est vidé entre deux messages et chaque message est appliqué seul, dès sa réception.
+ *
+ * Le lissage ne fait jamais démarrer ni changer de sens un moteur : ces transitions déclenchent l'overboost du
+ * pont en H, calculé sur la vitesse demandée. Elles sont appliquées en une fois, à la vitesse du message reçu.
+ */
+
+#pragma once
+#ifndef LISSAGE_h
+#define LISSAGE_h
+
+#include "Arduino.h"
+#include "pontH.h"
+
+#define LISSAGE_TAILLE 4 ///< Nombre de messages conservés dans le tampon
+
+/**
+ * @class lisseur
+ * @brief Tampon de gigue et extrapolation des commandes moteurs.
+ */
+class lisseur
+{
+public:
+    inline lisseur(uint8_t delaiArret);
+    inline ~lisseur() {}
+
+    inline void setRetard(uint8_t retard) { m_retard = retard < m_delaiArret ? retard : m_delaiArret; }
+    inline void setMaintien(uint8_t maintien) { m_maintien = maintien; }
+    inline uint8_t getRetard() const { return m_retard; }
+    inline uint8_t getMaintien() const { return m_maintien; }
+
+    /**
+     * @brief Indique si l'instant de rejeu a atteint un message
+     * @param instant Instant de réception du message en millisecondes
+     * @param maintenant Instant courant en millisecondes
+     */
+    inline bool rejoue(unsigned long instant, unsigned long maintenant) const { return (long)(maintenant - m_retard - instant) >= 0; }
+
+    inline void pousser(int16_t gauche, int16_t droit, unsigned long instant);
+    inline bool commande(unsigned long maintenant, int16_t & gauche, int16_t & droit);
+    inline void vider();
+
+    inline void afficher();
+
+private:
+    struct echantillon
+    {
+        unsigned long instant; ///< Instant de réception en millisecondes
+        int16_t       gauche;  ///< Vitesse du moteur gauche reçue
+        int16_t       droit;   ///< Vitesse du moteur droit reçue
+    };
+
+    inline echantillon const & lire(uint8_t age) const { return m_tampon[(m_tete + LISSAGE_TAILLE - age) % LISSAGE_TAILLE]; }
+    static inline int16_t interpoler(int16_t a, int16_t b, long numerateur, long denominateur);
+    static inline int16_t extrapoler(int16_t precedent, int16_t dernier, long intervalle, long prolongation);
+    static inline bool memeSens(int16_t a, int16_t b) { return (a > 0 && b > 0) || (a < 0 && b < 0); }
+
+private:
+    echantillon m_tampon[LISSAGE_TAILLE]; ///< Tampon circulaire des derniers messages reçus
+    uint8_t m_tete;                       ///< Indice du message le plus récent
+    uint8_t m_nombre;                     ///< Nombre de messages présents dans le tampon
+    uint8_t m_delaiArret;                 ///< Délai d'arrêt d'urgence en millisecondes, la commande est nulle avant
+    uint8_t m_retard;                     ///< Retard de rejeu en millisecondes
+    uint8_t m_maintien;                   ///< Durée de prolongation de la dernière commande en millisecondes
+    int16_t m_gauche;                     ///< Dernière commande gauche produite
+    int16_t m_droit;                      ///< Dernière commande droite produite
+};
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// //////////////////// Constructeurs et destructeurs /////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Constructeur de la classe lisseur
+ * @param delaiArret Délai en millisecondes sans message après lequel le bateau s'arrête
+ */
+inline lisseur::lisseur(uint8_t delaiArret)
+{
+    m_delaiArret = delaiArret;
+    m_retard = 20;
+    m_maintien = 40;
+    vider();
+}
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ///////////////////////// Fonctions publiques //////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Ajouter un message reçu au tampon
+ *
+ * @param gauche Vitesse du moteur gauche reçue
+ * @param droit Vitesse du moteur droit reçue
+ * @param instant Instant de réception du message en millisecondes
+ */
+inline void lisseur::pousser(int16_t gauche, int16_t droit, unsigned long instant)
+{
+    m_tete = (m_tete + 1) % LISSAGE_TAILLE;
+    m_tampon[m_tete].instant = instant;
+    m_tampon[m_tete].gauche = gauche;
+    m_tampon[m_tete].droit = droit;
+
+    if (m_nombre < LISSAGE_TAILLE) ++m_nombre;
+}
+
+/**
+ * @brief Calculer la commande à appliquer aux moteurs
+ *
+ * La commande est évaluée à l'instant `maintenant - retard` :
+ * - entre deux messages de même sens, elle est interpolée linéairement ; sinon la vitesse du message
+ *   suivant est appliquée directement ;
+ * - après le dernier message, elle est extrapolée pendant la durée de maintien, sans s'écarter du dernier
+ *   message de plus que la variation entre les deux derniers messages ni changer de sens, puis décroît
+ *   linéairement pour atteindre zéro au moment où l'arrêt d'urgence se déclencherait.
+ *
+ * @param maintenant Instant courant en millisecondes
+ * @param gauche [out] Vitesse du moteur gauche à appliquer
+ * @param droit [out] Vitesse du moteur droit à appliquer
+ * @return true si la commande a changé depuis le dernier appel, false sinon
+ */
+inline bool lisseur::commande(unsigned long maintenant, int16_t & gauche, int16_t & droit)
+{
+    if (!m_nombre) return false;
+
+    unsigned long rejeu = maintenant - m_retard;
+    echantillon const & dernier = lire(0);
+
+    if ((long)(rejeu - dernier.instant) >= 0)
+    {
+        // Aucun message après l'instant de rejeu : prolongation puis décroissance
+        unsigned long ecart = rejeu - dernier.instant;
+        unsigned long prolongation = ecart < m_maintien ? ecart : m_maintien;
+
+        gauche = dernier.gauche;
+        droit = dernier.droit;
+
+        if (m_nombre > 1)
+        {
+            echantillon const & precedent = lire(1);
+            long intervalle = dernier.instant - precedent.instant;
+            if (intervalle > 0)
+            {
+                gauche = extrapoler(precedent.gauche, dernier.gauche, intervalle, prolongation);
+                droit  = extrapoler(precedent.droit,  dernier.droit,  intervalle, prolongation);
+            }
+        }
+
+        if (ecart > m_maintien)
+        {
+            long extinction = (long)m_delaiArret - m_retard - m_maintien;
+            long reste = extinction - (long)(ecart - m_maintien);
+            if (reste < 0 || extinction <= 0) reste = 0;
+            gauche = interpoler(0, gauche, reste, extinction > 0 ? extinction : 1);
+            droit  = interpoler(0, droit,  reste, extinction > 0 ? extinction : 1);
+        }
+    }
+    else
+    {
+        // Recherche des deux messages qui encadrent l'instant de rejeu
+        uint8_t i = 1;
+        while (i < m_nombre && (long)(rejeu - lire(i).instant) < 0) ++i;
+
+        echantillon const & suivant = lire(i - 1);
+        if (i < m_nombre)
+        {
+            echantillon const & avant = lire(i);
+            long intervalle = suivant.instant - avant.instant;
+            gauche = memeSens(avant.gauche, suivant.gauche) ? interpoler(avant.gauche, suivant.gauche, rejeu - avant.instant, intervalle) : suivant.gauche;
+            droit  = memeSens(avant.droit,  suivant.droit)  ? interpoler(avant.droit,  suivant.droit,  rejeu - avant.instant, intervalle) : suivant.droit;
+        }
+        else
+        {
+            // Tous les messages sont postérieurs à l'instant de rejeu : maintien du plus ancien
+            gauche = suivant.gauche;
+            droit = suivant.droit;
+        }
+    }
+
+    bool change = gauche != m_gauche || droit != m_droit;
+    m_gauche = gauche;
+    m_droit = droit;
+    return change;
+}
+
+/**
+ * @brief Vider le tampon
+ *
+ * Cette fonction doit être appelée lorsque les moteurs sont arrêtés par l'arrêt d'urgence.
+ */
+inline void lisseur::vider()
+{
+    m_tete = 0;
+    m_nombre = 0;
+    m_gauche = 0;
+    m_droit = 0;
+}
+
+/**
+ * @brief Afficher les paramètres sur le port série
+ */
+inline void lisseur::afficher()
+{
+    Serial.print(F("Retard = "));
+    Serial.print(m_retard);
+    Serial.print(F(" Maintien = "));
+    Serial.println(m_maintien);
+}
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ///////////////////////// Fonctions privés ////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Interpoler ou extrapoler linéairement entre deux vitesses
+ *
+ * @param a Vitesse à la position 0
+ * @param b Vitesse à la position `denominateur`
+ * @param numerateur Position recherchée
+ * @param denominateur Distance entre les deux vitesses connues (strictement positive)
+ * @return Vitesse à la position `numerateur`, limitée entre -PONTH_VITESSE_MAX et PONTH_VITESSE_MAX
+ */
+inline int16_t lisseur::interpoler(int16_t a, int16_t b, long numerateur, long denominateur)
+{
+    long v = a + ((long)(b - a) * numerateur) / denominateur;
+    return constrain(v, -PONTH_VITESSE_MAX, PONTH_VITESSE_MAX);
+}
+
+/**
+ * @brief Extrapoler une vitesse au-delà du dernier message
+ *
+ * La variation extrapolée est limitée à la variation entre les deux derniers messages : deux messages
+ * reçus à quelques millisecondes d'intervalle ne doivent pas produire une pente démesurée. L'extrapolation
+ * ne démarre ni n'inverse jamais le moteur : la vitesse du dernier message est alors conservée.
+ *
+ * @param precedent Vitesse de l'avant-dernier message
+ * @param dernier Vitesse du dernier message
+ * @param intervalle Durée entre les deux derniers messages (strictement positive)
+ * @param prolongation Durée d'extrapolation après le dernier message
+ * @return Vitesse extrapolée, limitée entre -PONTH_VITESSE_MAX et PONTH_VITESSE_MAX
+ */
+inline int16_t lisseur::extrapoler(int16_t precedent, int16_t dernier, long intervalle, long prolongation)
+{
+    long variation = dernier - precedent;
+    long delta = (variation * prolongation) / intervalle;
+    delta = constrain(delta, -abs(variation), abs(variation));
+
+    long v = constrain(dernier + delta, -PONTH_VITESSE_MAX, PONTH_VITESSE_MAX);
+    return v == 0 || memeSens(v, dernier) ? v : dernier;
+}
+
+#endif
@@ -15,6 +15,15 @@
 
 #include "common.h"
 
+#define PONTH_VITESSE_MAX 511 ///< Vitesse maximale d'un moteur, en avant comme en arrière
+
+// **Trace détaillée de l'overboost, trop bavarde pour le port série lorsque la commande change à chaque milliseconde**
+#ifdef PONTH_DEBUG
+#define ponthDebugln(...) debugln(__VA_ARGS__)
+#else
+#define ponthDebugln(...)
+#endif
+
 class pontH
 {
 public:
@@ -22,15 +31,17 @@ public:
     inline ~pontH() {}
 
 
-    inline void vitesseMoteurs(int8_t const &gauche, int8_t const &droit);
+    inline void vitesseMoteurs(int16_t const &gauche, int16_t const &droit);
     inline void stopMoteurs();
 
 
     inline void setRegimeMinimum(uint8_t regimeMinimum);
     inline void setOverBoostDelay(uint8_t overBoostDelay);
+    inline uint8_t getRegimeMinimum() const { return m_regimeMinimum; }
+    inline uint8_t getOverBoostDelay() const { return m_overBoostDelay; }
 
 private:    
-    inline void speedToPwmDirection(int8_t &vitesse, uint8_t &pwm, bool &direction);
+    inline void speedToPwmDirection(int16_t &vitesse, uint8_t &pwm, bool &direction);
     inline void computeOverDriveDelay(int const leftRight, uint8_t const & pwm, bool direction, int8_t & delai);
     inline void applyDrive(uint8_t & pwmGauche, bool & directionGauche, int8_t & overdriveDelaiGauche, uint8_t & pwmDroit, bool & directionDroite, int8_t & overdriveDelaiDroit);
 
@@ -40,7 +51,7 @@ private:
     int m_directionPin[2];    /// Tableau stockant les broches de direction des moteurs
     uint8_t m_regimeMinimum;  /// Vitesse minimum autre que 0 pour un moteur. Exprimer en ratio PWM entre 0 et 255. Par défault 127.
     uint8_t m_overBoostDelay; /// Délai d'overdrive de référence quand un moteur est à sont régime minimum
-    uint8_t m_vitesse[2];     /// Tableau stockant la vitesse des moteurs
+    int16_t m_vitesse[2];     /// Tableau stockant la vitesse des moteurs
 };
 
 
@@ -116,14 +127,14 @@ inline void pontH::setOverBoostDelay(uint8_t overBoostDelay) { m_overBoostDelay
  * @brief Définir la vitesse des moteurs
  *
  * Cette fonction définit la vitesse des deux moteurs en fonction des valeurs de vitesse fournies
- * pour la direction gauche et droite. Les valeurs de vitesse doivent être comprises entre -100 et 100.
- * @param gauche Vitesse du moteur gauche (-100 pour la vitesse maximale en arrière, 0 pour à l'arrét, 100 pour la vitesse maximale en avant)
- * @param droit  Vitesse du moteur droit  (-100 pour la vitesse maximale en arrière, 0 pour à l'arrét, 100 pour la vitesse maximale en avant)
+ * pour la direction gauche et droite. Les valeurs de vitesse doivent être comprises entre -PONTH_VITESSE_MAX et PONTH_VITESSE_MAX.
+ * @param gauche Vitesse du moteur gauche (-PONTH_VITESSE_MAX pour la vitesse maximale en arrière, 0 pour à l'arrét, PONTH_VITESSE_MAX pour la vitesse maximale en avant)
+ * @param droit  Vitesse du moteur droit  (-PONTH_VITESSE_MAX pour la vitesse maximale en arrière, 0 pour à l'arrét, PONTH_VITESSE_MAX pour la vitesse maximale en avant)
  */
-inline void pontH::vitesseMoteurs(int8_t const &gauche, int8_t const &droit)
+inline void pontH::vitesseMoteurs(int16_t const &gauche, int16_t const &droit)
 {
-    int8_t  vitesseGauche = gauche;
-    int8_t  vitesseDroite = droit;
+    int16_t vitesseGauche = gauche;
+    int16_t vitesseDroite = droit;
     uint8_t pwmGauche;
     uint8_t pwmDroite;
     bool    directionGauche;
@@ -179,21 +190,21 @@ inline void pontH::stopMoteurs()
  *
  * Cette fonction interne calcule la configuration d'un moteur en fonction de la valeur de vitesse fournie.
  *
- * @param vitesse [in, out] Vitesse du moteur (-100 pour la vitesse maximale en arrière, 0 pour à l'arrêt, 100 pour la vitesse maximale en avant)
+ * @param vitesse [in, out] Vitesse du moteur (-PONTH_VITESSE_MAX pour la vitesse maximale en arrière, 0 pour à l'arrêt, PONTH_VITESSE_MAX pour la vitesse maximale en avant)
  * @param pwm [out] Valeur à écrire sur la broche PWM du moteur
  * @param direction [out] Direction du moteur (true pour avancer, false pour reculer)
  */
-inline void pontH::speedToPwmDirection(int8_t &vitesse, uint8_t &pwm, bool &direction)
+inline void pontH::speedToPwmDirection(int16_t &vitesse, uint8_t &pwm, bool &direction)
 {
-    if (vitesse > +100) vitesse = +100;
-    if (vitesse < -100) vitesse = -100;
+    if (vitesse > +PONTH_VITESSE_MAX) vitesse = +PONTH_VITESSE_MAX;
+    if (vitesse < -PONTH_VITESSE_MAX) vitesse = -PONTH_VITESSE_MAX;
 
     direction = vitesse >= 0;
-    int8_t vitesseAbs = abs(vitesse);
+    int16_t vitesseAbs = abs(vitesse);
 
     if (vitesseAbs)
     {
-        pwm = map(vitesseAbs, 0, 100, m_regimeMinimum, 255);
+        pwm = map(vitesseAbs, 0, PONTH_VITESSE_MAX, m_regimeMinimum, 255);
     }
     else
     {
@@ -216,33 +227,33 @@ inline void pontH::computeOverDriveDelay(int const leftRight, uint8_t const & pw
 
     if(pwm)
     {
-        int8_t vitesseOld = m_vitesse[leftRight];
+        int16_t vitesseOld = m_vitesse[leftRight];
         uint8_t pwmOld = 0;
         bool   directionOld = false;
 
         speedToPwmDirection(vitesseOld, pwmOld, directionOld);
-        debugln("********");
-        debugln(pwm);
-        debugln(direction);
-        debugln("-----");
-        debugln(vitesseOld);
-        debugln(pwmOld);
-        debugln(directionOld);
+        ponthDebugln(F("********"));
+        ponthDebugln(pwm);
+        ponthDebugln(direction);
+        ponthDebugln(F("-----"));
+        ponthDebugln(vitesseOld);
+        ponthDebugln(pwmOld);
+        ponthDebugln(directionOld);
         if(directionOld != direction || pwmOld == 0)
         {
             uint8_t pwmDiff = pwm - m_regimeMinimum;
             delai = map(pwmDiff, m_regimeMinimum, 0, 0, m_overBoostDelay);
-            debugln(delai); 
+            ponthDebugln(delai); 
         }
         else
         {
-            debugln("Drection is same");            
+            ponthDebugln(F("Drection is same"));            
         }
-        debugln("********");
+        ponthDebugln(F("********"));
     }
     else
     {
-        //debugln("pwm=0");
+        //debugln(F("pwm=0"));
     }
 
 
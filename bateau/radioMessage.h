@@ -1,27 +1,169 @@
+/**
+ * @file radioMessage.h
+ * @author Florent LERAY, Jérémy Lefort Besnard
+ * @date 2024-03-06
+ * @brief Définit le message échangé entre la télécommande et le bateau, et son codage binaire compact.
+ *
+ * Le message est manipulé en mémoire sous la forme de la structure `radioMessage`, puis codé champ par champ
+ * dans une trame `radioTrame` de TRAME_TAILLE octets pour limiter le temps d'émission. Chaque champ est décrit
+ * à la compilation par le gabarit `champ`, qui calcule sa position, son octet de départ et son masque.
+ *
+ * Disposition de la trame (bits, du poids faible de l'octet 0 vers l'octet 5) :
+ * | check (8) | gauche (10) | droit (10) | cmd (3) | boutons (7) | jeton (8) |
+ */
+
 #pragma once
 #ifndef RADIOMESSAGE_h
 #define RADIOMESSAGE_h
 
-typedef enum 
+#include <stdint.h>
+
+typedef enum
 {
+    AUCUNE = 0,
     PA_MIN = 1,
     PA_LOW = 2,
-    PA_HI  = 4,
-    PA_MAX = 8,
-    RESET  = 16
+    PA_HI  = 3,
+    PA_MAX = 4,
+    RESET  = 5
 } radioCmd;
 
 
 typedef struct
 {
-    char cmd;
-    char gauche;
-    char droit;
-    char check;
+    uint8_t cmd;     // Commande radioCmd
+    int16_t gauche;  // Vitesse du moteur gauche, entre -RADIO_VITESSE_MAX et RADIO_VITESSE_MAX
+    int16_t droit;   // Vitesse du moteur droit, entre -RADIO_VITESSE_MAX et RADIO_VITESSE_MAX
+    uint8_t boutons; // Masque des boutons de la télécommande (A à K)
+    uint8_t jeton;   // Jeton de mesure de latence, renvoyé par le bateau dans l'acquittement (0 = aucun)
 } radioMessage;
 
-inline char computeCheck  (radioMessage const & msg) { return msg.cmd ^ msg.gauche ^ msg.droit; }
-inline void assignCheck   (radioMessage       & msg) { msg.check = computeCheck(msg); }
-inline bool messageIsValid(radioMessage const & msg) { return msg.check == computeCheck(msg); }
-#endif
+typedef struct
+{
+    uint8_t  jeton;  // Jeton du message mesuré
+    uint32_t delai;  // Délai en microsecondes entre la réception du message et l'application des PWM
+} radioEcho;
+
+
+/**
+ * @brief Description d'un champ de bits de la trame radio
+ *
+ * @tparam Position Position du premier bit du champ dans la trame
+ * @tparam Largeur Nombre de bits du champ (16 au plus si signé, 15 sinon)
+ * @tparam Signe true si le champ contient un entier signé (complément à deux)
+ */
+template<uint8_t Position, uint8_t Largeur, bool Signe = false>
+struct champ
+{
+    static constexpr uint8_t  fin      = Position + Largeur;                   ///< Position du bit suivant le champ
+    static constexpr uint8_t  octet    = Position / 8;                         ///< Premier octet occupé par le champ
+    static constexpr uint8_t  decalage = Position % 8;                         ///< Position du champ dans son premier octet
+    static constexpr uint8_t  nbOctets = (decalage + Largeur + 7) / 8;         ///< Nombre d'octets occupés par le champ
+    static constexpr uint32_t masque   = ((1UL << Largeur) - 1) << decalage;   ///< Masque du champ dans ses octets
+    static constexpr int16_t  maximum  = Signe ? (1L << (Largeur - 1)) - 1 : (1L << Largeur) - 1; ///< Plus grande valeur codable
+    static constexpr int16_t  minimum  = Signe ? -maximum : 0;                 ///< Plus petite valeur codée (symétrique si signé)
+
+    static_assert(Largeur > 0 && Largeur <= (Signe ? 16 : 15), "Un champ doit tenir dans un int16_t");
+    static_assert(decalage + Largeur <= 24, "Un champ s'étend sur 3 octets au plus");
+
+    /**
+     * @brief Écrire une valeur dans la trame, limitée aux bornes du champ
+     */
+    static inline void ecrire(uint8_t * trame, int16_t valeur)
+    {
+        if (valeur < minimum) valeur = minimum;
+        if (valeur > maximum) valeur = maximum;
+
+        uint32_t fenetre = 0;
+        for (uint8_t i = 0; i < nbOctets; ++i) fenetre |= (uint32_t)trame[octet + i] << (8 * i);
+
+        fenetre = (fenetre & ~masque) | (((uint32_t)(uint16_t)valeur << decalage) & masque);
+
+        for (uint8_t i = 0; i < nbOctets; ++i) trame[octet + i] = fenetre >> (8 * i);
+    }
+
+    /**
+     * @brief Écrire un masque de bits dans la trame, les bits au-delà de la largeur du champ sont ignorés
+     *
+     * Contrairement à `ecrire()`, la valeur n'est pas limitée : un masque trop large limité au maximum du
+     * champ aurait tous ses bits à 1.
+     */
+    static inline void ecrireMasque(uint8_t * trame, uint16_t valeur)
+    {
+        static_assert(!Signe, "Un masque de bits n'est pas signé");
+        ecrire(trame, valeur & maximum);
+    }
+
+    /**
+     * @brief Lire la valeur du champ dans la trame
+     */
+    static inline int16_t lire(const uint8_t * trame)
+    {
+        uint32_t fenetre = 0;
+        for (uint8_t i = 0; i < nbOctets; ++i) fenetre |= (uint32_t)trame[octet + i] << (8 * i);
+
+        int32_t valeur = (fenetre & masque) >> decalage;
+        if (Signe && (valeur & (1L << (Largeur - 1)))) valeur -= 1L << Largeur;
+        return valeur;
+    }
+};
 
+typedef champ<0,                  8       > champCheck;
+typedef champ<champCheck::fin,   10, true > champGauche;
+typedef champ<champGauche::fin,  10, true > champDroit;
+typedef champ<champDroit::fin,    3       > champCmd;
+typedef champ<champCmd::fin,      7       > champBoutons;
+typedef champ<champBoutons::fin,  8       > champJeton;
+
+#define TRAME_TAILLE      ((champJeton::fin + 7) / 8)     ///< Taille de la trame radio en octets
+#define RADIO_VITESSE_MAX ((int16_t)champGauche::maximum) ///< Vitesse maximale transmise pour un moteur
+#define CHECK_GRAINE      0xA5                            ///< Valeur initiale du contrôle, une trame nulle est invalide
+
+static_assert(TRAME_TAILLE <= 6, "La trame radio doit tenir sur 6 octets");
+static_assert(RESET <= champCmd::maximum, "Les commandes doivent tenir dans le champ cmd");
+
+typedef struct
+{
+    uint8_t octets[TRAME_TAILLE];
+} radioTrame;
+
+inline uint8_t computeCheck(radioTrame const & trame)
+{
+    uint8_t check = CHECK_GRAINE;
+    for (uint8_t i = champCheck::fin / 8; i < TRAME_TAILLE; ++i) check ^= trame.octets[i];
+    return check;
+}
+
+inline bool messageIsValid(radioTrame const & trame) { return champCheck::lire(trame.octets) == computeCheck(trame); }
+
+/**
+ * @brief Coder un message dans une trame radio, contrôle compris
+ */
+inline void encoder(radioMessage const & msg, radioTrame & trame)
+{
+    for (uint8_t i = 0; i < TRAME_TAILLE; ++i) trame.octets[i] = 0;
+
+    champGauche ::ecrire(trame.octets, msg.gauche);
+    champDroit  ::ecrire(trame.octets, msg.droit);
+    champCmd    ::ecrire(trame.octets, msg.cmd);
+    champBoutons::ecrireMasque(trame.octets, msg.boutons);
+    champJeton  ::ecrire(trame.octets, msg.jeton);
+    champCheck  ::ecrire(trame.octets, computeCheck(trame));
+}
+
+/**
+ * @brief Décoder une trame radio
+ * @return true si le contrôle de la trame est valide, false sinon (le message n'est alors pas modifié)
+ */
+inline bool decoder(radioTrame const & trame, radioMessage & msg)
+{
+    if (!messageIsValid(trame)) return false;
+
+    msg.gauche  = champGauche ::lire(trame.octets);
+    msg.droit   = champDroit  ::lire(trame.octets);
+    msg.cmd     = champCmd    ::lire(trame.octets);
+    msg.boutons = champBoutons::lire(trame.octets);
+    msg.jeton   = champJeton  ::lire(trame.octets);
+    return true;
+}
+#endif
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# budget.sh : rapport d'occupation mémoire flash et RAM des croquis `bateau` et `telecomande`.
+#
+# Compile chaque croquis avec arduino-cli, puis lit l'ELF produit :
+#  - totaux par section avec avr-size ;
+#  - occupation par symbole avec avr-nm, triée par taille décroissante et séparée entre
+#    flash (.text, .progmem) et RAM (.data, .bss). Les symboles de .data occupent les deux.
+#
+# Utilisation : outils/budget.sh [croquis...]   (par défaut : bateau telecomande)
+# Variables   : FQBN (par défaut arduino:avr:nano), NB_SYMBOLES (par défaut 20)
+#
+
+set -e
+
+FQBN=${FQBN:-arduino:avr:nano}
+NB_SYMBOLES=${NB_SYMBOLES:-20}
+RACINE=$(cd "$(dirname "$0")/.." && pwd)
+CROQUIS=${*:-bateau telecomande}
+
+for croquis in $CROQUIS
+do
+    build="$RACINE/_build/$croquis"
+    arduino-cli compile --fqbn "$FQBN" --build-path "$build" "$RACINE/$croquis" > /dev/null
+    elf="$build/$croquis.ino.elf"
+
+    echo "==================== $croquis ($FQBN) ===================="
+    avr-size -C --mcu=atmega328p "$elf"
+
+    echo "---- Flash : $NB_SYMBOLES plus gros symboles (octets) ----"
+    avr-nm -C -S --size-sort -r -t d "$elf" | awk '$3 ~ /^[TtWw]$/' | head -n "$NB_SYMBOLES" \
+        | awk '{ printf "%6d  %s\n", $2 + 0, substr($0, index($0, $4)) }'
+
+    echo "---- RAM : $NB_SYMBOLES plus gros symboles (octets) ----"
+    avr-nm -C -S --size-sort -r -t d "$elf" | awk '$3 ~ /^[DdBbVv]$/' | head -n "$NB_SYMBOLES" \
+        | awk '{ printf "%6d  %s  %s\n", $2 + 0, ($3 ~ /^[Dd]$/ ? "data" : "bss "), substr($0, index($0, $4)) }'
+    echo
+done
@@ -0,0 +1,178 @@
+/**
+ * @file console.h
+ * @author Florent LERAY, Jérémy Lefort Besnard
+ * @date 2024-03-06
+ * @brief Définit la classe `console` pour lire des commandes texte sur le port série sans bloquer.
+ *
+ * La console accumule les caractères reçus dans un tampon de ligne. Chaque appel à `poll()` ne lit
+ * qu'un nombre borné de caractères, ce qui permet de l'appeler depuis `loop()` sans ralentir la boucle
+ * de contrôle. Une fois la ligne terminée (retour chariot ou saut de ligne), elle est découpée en un mot
+ * de commande et un argument optionnel.
+ */
+
+#pragma once
+#ifndef CONSOLE_h
+#define CONSOLE_h
+
+#include "Arduino.h"
+
+#define CONSOLE_TAILLE_LIGNE 24 ///< Taille maximale d'une ligne de commande (zéro terminal compris)
+#define CONSOLE_BUDGET       16 ///< Nombre maximal de caractères traités par appel à poll()
+
+/**
+ * @class console
+ * @brief Analyseur de commandes série non bloquant.
+ */
+class console
+{
+public:
+    inline console();
+    inline ~console() {}
+
+    inline bool poll();
+
+    inline bool commande(const char * nomP) const;
+    inline const char * argument() const { return m_argument; }
+    inline long argumentEntier(long defaut) const;
+
+    inline void effacer();
+
+private:
+    inline void terminerLigne();
+
+private:
+    char    m_ligne[CONSOLE_TAILLE_LIGNE]; ///< Tampon de la ligne en cours de saisie
+    uint8_t m_taille;                      ///< Nombre de caractères présents dans le tampon
+    bool    m_pret;                        ///< Indique qu'une ligne complète attend d'être traitée
+    bool    m_debordement;                 ///< Indique que la ligne en cours a dépassé la taille du tampon
+    char *  m_argument;                    ///< Pointeur vers l'argument de la ligne (chaîne vide si absent)
+};
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// //////////////////// Constructeurs et destructeurs /////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Constructeur de la classe console
+ */
+inline console::console()
+{
+    effacer();
+}
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ///////////////////////// Fonctions publiques //////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Lire les caractères disponibles sur le port série
+ *
+ * Cette fonction lit au plus `CONSOLE_BUDGET` caractères et ne bloque jamais. Les caractères sont convertis
+ * en majuscules. Une ligne trop longue est ignorée en entier.
+ *
+ * @return true si une ligne complète est prête à être traitée, false sinon
+ */
+inline bool console::poll()
+{
+    if (m_pret) return true;
+
+    for (uint8_t budget = CONSOLE_BUDGET; budget && Serial.available(); --budget)
+    {
+        char c = toupper(Serial.read());
+
+        if (c == '\r' || c == '\n')
+        {
+            if (m_taille && !m_debordement)
+            {
+                terminerLigne();
+                return true;
+            }
+            effacer();
+        }
+        else if (m_taille < CONSOLE_TAILLE_LIGNE - 1)
+        {
+            m_ligne[m_taille++] = c;
+        }
+        else
+        {
+            m_debordement = true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Comparer le mot de commande de la ligne reçue
+ *
+ * @param nomP Nom de la commande, stocké en mémoire flash (utiliser PSTR("..."))
+ * @return true si la ligne reçue correspond à cette commande, false sinon
+ */
+inline bool console::commande(const char * nomP) const
+{
+    return m_pret && strcmp_P(m_ligne, nomP) == 0;
+}
+
+/**
+ * @brief Lire l'argument de la ligne reçue sous forme d'entier
+ *
+ * @param defaut Valeur renvoyée si la ligne ne contient pas d'argument
+ * @return La valeur de l'argument, ou `defaut` s'il est absent
+ */
+inline long console::argumentEntier(long defaut) const
+{
+    return *m_argument ? atol(m_argument) : defaut;
+}
+
+/**
+ * @brief Vider le tampon de ligne
+ *
+ * Cette fonction doit être appelée une fois la commande traitée pour pouvoir recevoir la suivante.
+ */
+inline void console::effacer()
+{
+    m_taille = 0;
+    m_pret = false;
+    m_debordement = false;
+    m_ligne[0] = '\0';
+    m_argument = m_ligne;
+}
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ///////////////////////// Fonctions privés ////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Terminer la ligne et la découper en commande et argument
+ *
+ * Le premier espace sépare le mot de commande de son argument.
+ */
+inline void console::terminerLigne()
+{
+    m_ligne[m_taille] = '\0';
+    m_argument = m_ligne + m_taille;
+
+    for (char * p = m_ligne; *p; ++p)
+    {
+        if (*p == ' ')
+        {
+            *p = '\0';
+            m_argument = p + 1;
+            break;
+        }
+    }
+    m_pret = true;
+}
+
+#endif
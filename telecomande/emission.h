@@ -0,0 +1,205 @@
+/**
+ * @file emission.h
+ * @author Florent LERAY, Jérémy Lefort Besnard
+ * @date 2024-03-06
+ * @brief Définit la classe `emetteur` pour envoyer des messages radio sans bloquer la boucle principale.
+ *
+ * Contrairement à `RF24::write()`, qui attend la fin de toutes les retransmissions automatiques, l'émetteur
+ * charge le message dans la FIFO d'émission de la radio et rend la main immédiatement. L'état de la FIFO est
+ * ensuite surveillé par `poll()`, qui signale de manière asynchrone les acquittements et les échecs.
+ * Un seul message est en vol à la fois. Un message envoyé pendant ce temps attend dans une case unique,
+ * chargée dans la radio par `poll()` dès que le message en vol est acquitté ou abandonné ; un message plus
+ * récent écrase celui qui attend, car seule la dernière position du joystick intéresse le bateau. Un
+ * message déjà dans la FIFO n'est jamais retiré : son acquittement tardif validerait le message suivant.
+ * Si la radio ne signale ni acquittement ni échec dans le délai EMISSION_DELAI_MAX, par exemple après une
+ * chute de son alimentation, le message en vol est abandonné comme un échec pour ne pas bloquer l'émission.
+ */
+
+#pragma once
+#ifndef EMISSION_h
+#define EMISSION_h
+
+#include <RF24.h>
+
+#define EMISSION_OK    0b00000001 ///< Le message en vol a été acquitté par le bateau
+#define EMISSION_ECHEC 0b00000010 ///< Le message en vol a épuisé ses retransmissions sans acquittement
+
+#define EMISSION_TAILLE_MAX 8     ///< Taille maximale d'un message en octets
+#define EMISSION_DELAI_MAX  30    ///< Délai en millisecondes avant d'abandonner un message en vol (15 retransmissions de 1,5 ms et une marge)
+
+/**
+ * @class emetteur
+ * @brief File d'émission radio non bloquante à un seul message en vol.
+ */
+class emetteur
+{
+public:
+    inline emetteur(RF24 & radio);
+    inline ~emetteur() {}
+
+    inline bool envoyer(const void * message, uint8_t taille, bool marque = false);
+    inline uint8_t poll();
+
+    inline bool occupe() const { return m_enVol || m_enAttente; }
+    inline bool marque() const { return m_marqueTermine; }
+
+    inline uint32_t acquittes()  const { return m_acquittes; }
+    inline uint32_t echecs()     const { return m_echecs; }
+    inline uint32_t remplaces()  const { return m_remplaces; }
+    inline uint32_t expires()    const { return m_expires; }
+
+private:
+    inline void charger();
+
+private:
+    RF24 &   m_radio;                        ///< Radio utilisée pour l'émission
+    bool     m_enVol;                        ///< Un message est chargé dans la FIFO d'émission et attend son acquittement
+    bool     m_enAttente;                    ///< Un message attend dans la case m_message que la radio soit libre
+    bool     m_marqueVol;                    ///< Marque du message en vol
+    bool     m_marqueAttente;                ///< Marque du message en attente
+    bool     m_marqueTermine;                ///< Marque du message concerné par les derniers évènements de poll()
+    uint8_t  m_taille;                       ///< Taille du message en attente
+    uint8_t  m_message[EMISSION_TAILLE_MAX]; ///< Case du message en attente
+    unsigned long m_depart;                  ///< Instant de chargement du message en vol en millisecondes
+    uint32_t m_acquittes;                    ///< Nombre de messages acquittés par le bateau
+    uint32_t m_echecs;                       ///< Nombre de messages non acquittés après toutes les retransmissions
+    uint32_t m_remplaces;                    ///< Nombre de messages en attente écrasés par un message plus récent avant leur émission
+    uint32_t m_expires;                      ///< Nombre d'échecs dus à l'expiration du délai EMISSION_DELAI_MAX
+};
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// //////////////////// Constructeurs et destructeurs /////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Constructeur de la classe emetteur
+ * @param radio Radio utilisée pour l'émission, déjà configurée et hors écoute
+ */
+inline emetteur::emetteur(RF24 & radio) : m_radio(radio)
+{
+    m_enVol = false;
+    m_enAttente = false;
+    m_marqueVol = false;
+    m_marqueAttente = false;
+    m_marqueTermine = false;
+    m_taille = 0;
+    m_depart = 0;
+    m_acquittes = 0;
+    m_echecs = 0;
+    m_remplaces = 0;
+    m_expires = 0;
+}
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ///////////////////////// Fonctions publiques //////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Envoyer un message sans attendre son acquittement
+ *
+ * Si la radio est libre, le message est chargé immédiatement. Sinon il attend dans la case unique, en
+ * écrasant le message qui y attendait déjà. Le résultat de l'envoi est signalé plus tard par `poll()`.
+ *
+ * @param message Message à envoyer
+ * @param taille Taille du message en octets (EMISSION_TAILLE_MAX au plus)
+ * @param marque Marque associée au message, restituée par `marque()` avec ses évènements
+ * @return false si le message est trop long, true sinon
+ */
+inline bool emetteur::envoyer(const void * message, uint8_t taille, bool marque)
+{
+    if (taille > EMISSION_TAILLE_MAX) return false;
+
+    if (m_enAttente) ++m_remplaces;
+
+    memcpy(m_message, message, taille);
+    m_taille = taille;
+    m_marqueAttente = marque;
+    m_enAttente = true;
+
+    if (!m_enVol) charger();
+    return true;
+}
+
+/**
+ * @brief Surveiller l'état du message en vol
+ *
+ * Cette fonction ne lit que les registres d'état de la radio et ne bloque jamais. Elle doit être appelée
+ * à chaque passage de la boucle principale. Lorsque le message en vol est terminé, le message en attente
+ * est chargé dans la radio. Un message en vol depuis plus de EMISSION_DELAI_MAX est signalé en échec.
+ *
+ * @return Masque des évènements survenus depuis le dernier appel (EMISSION_OK, EMISSION_ECHEC)
+ */
+inline uint8_t emetteur::poll()
+{
+    if (!m_enVol) return 0;
+
+    bool ok, echec, recu;
+    m_radio.whatHappened(ok, echec, recu);
+
+    if (ok)
+    {
+        ++m_acquittes;
+    }
+    else if (echec)
+    {
+        ++m_echecs;
+        m_radio.flush_tx();
+    }
+    else if (millis() - m_depart > EMISSION_DELAI_MAX)
+    {
+        // La radio ne signale plus rien : le message est retiré et la radio remise en veille
+        ++m_echecs;
+        ++m_expires;
+        m_radio.flush_tx();
+        m_radio.txStandBy();
+    }
+    else
+    {
+        return 0;
+    }
+
+    m_enVol = false;
+    m_marqueTermine = m_marqueVol;
+
+    if (m_enAttente)
+    {
+        charger();
+    }
+    else
+    {
+        // La FIFO d'émission est vide : le retour en veille est immédiat
+        m_radio.txStandBy();
+    }
+
+    return ok ? EMISSION_OK : EMISSION_ECHEC;
+}
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ///////////////////////// Fonctions privés ////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Charger le message en attente dans la FIFO d'émission, qui doit être vide
+ */
+inline void emetteur::charger()
+{
+    m_radio.startFastWrite(m_message, m_taille, false);
+    m_depart = millis();
+    m_enVol = true;
+    m_marqueVol = m_marqueAttente;
+    m_enAttente = false;
+}
+
+#endif
@@ -30,6 +30,9 @@
 #define maskBoutonE 0b00010000   ///< Masque binaire du bouton E
 #define maskBoutonF 0b00100000   ///< Masque binaire du bouton F
 #define maskBoutonK 0b01000000   ///< Masque binaire du bouton K
+#define maskBoutons 0b01111111   ///< Masque binaire de tous les boutons
+
+#define JOYPAD_ANTIREBOND 20      ///< Durée en millisecondes pendant laquelle les boutons doivent rester immobiles pour être pris en compte
 
 // **Broches des axes analogiques**
 #define x_axis A0 ///< Broche de l'axe X
@@ -62,6 +65,28 @@ public:
      */
     void calibration(uint8_t const & pin);
 
+    /**
+     * @brief Démarrer un calibrage non bloquant du joystick
+     *
+     * Cette fonction mémorise la position de repos et réinitialise les extrémités des axes. Le calibrage
+     * se poursuit ensuite à chaque appel de `suivreCalibration()`.
+     */
+    void demarrerCalibration();
+
+    /**
+     * @brief Poursuivre le calibrage non bloquant du joystick
+     *
+     * Cette fonction lit une fois les axes et met à jour leurs extrémités. Elle termine le calibrage
+     * lorsque le bouton 'pin' est pressé.
+     * @param pin La broche utilisée pour arrêter le calibrage (en appuyant dessus)
+     * @return true si le calibrage est toujours en cours, false sinon
+     */
+    bool suivreCalibration(uint8_t const & pin);
+
+    /**
+     * @brief Indique si un calibrage non bloquant est en cours
+     */
+    inline bool calibrationEnCours() const { return m_calibrationEnCours; }
 
     /**
      * @brief Calibrer le joystick au repos
@@ -79,6 +104,16 @@ public:
      */
     void getAxis(int8_t &x, int8_t &y);
 
+    /**
+     * @brief Lire les valeurs des axes du joystick avec une amplitude donnée
+     *
+     * Cette fonction lit les axes à la pleine résolution du convertisseur et les ramène entre -amplitude et +amplitude.
+     * @param x Variable de référence pour stocker la valeur de l'axe X
+     * @param y Variable de référence pour stocker la valeur de l'axe Y
+     * @param amplitude Valeur renvoyée lorsque l'axe est en butée
+     */
+    void getAxis(int16_t &x, int16_t &y, int16_t amplitude);
+
     /**
      * @brief Lire l'état de tous les boutons
      *
@@ -121,8 +156,30 @@ public:
      */
     inline uint8_t changed() { return m_changed; }
 
+    /**
+     * @brief Fonction utilitaire pour lire l'état anti-rebond des boutons
+     *
+     * Ce masque n'est mis à jour que lorsque les lectures de getButton() n'ont pas changé depuis au moins
+     * JOYPAD_ANTIREBOND millisecondes : les rebonds des contacts sont ainsi ignorés.
+     * @return Masque binaire de l'état stable de tous les boutons
+     */
+    inline uint8_t stable() const { return m_stable; }
+
     inline void check();
 
+    /**
+     * @brief Afficher l'état des boutons et des axes sur le port série
+     * @param boutons Masque binaire contenant l'état de tous les boutons
+     * @param x Valeur de l'axe X en pourcentage
+     * @param y Valeur de l'axe Y en pourcentage
+     */
+    inline void afficher(uint8_t const & boutons, int8_t const & x, int8_t const & y) const;
+
+    /**
+     * @brief Afficher les valeurs de calibrage des axes sur le port série
+     */
+    inline void afficherCalibration() const;
+
 private:
     /**
      * @brief Stocke l'état précédent des boutons
@@ -134,6 +191,21 @@ private:
      */
     uint8_t m_changed;
 
+    /**
+     * @brief Stocke l'état anti-rebond des boutons
+     */
+    uint8_t m_stable;
+
+    /**
+     * @brief Instant du dernier changement des boutons lus, en millisecondes
+     */
+    unsigned long m_instantChangement;
+
+    /**
+     * @brief Indique si un calibrage non bloquant est en cours
+     */
+    bool m_calibrationEnCours;
+
     /**
      * @brief Valeurs minimale, à l'origine, et maximale de l'axe X lues lors du calibrage
      */
@@ -165,6 +237,9 @@ joypad::joypad()
 
     m_oldPressed = 0;
     m_changed = 0;
+    m_stable = 0;
+    m_instantChangement = 0;
+    m_calibrationEnCours = false;
 
     m_xMin = 0;                      // Valeur initiale pour la valeur minimale de l'axe X
     m_xOri = ((1 << 10) - 1) >> 2;   // Valeur initiale pour la valeur à l'origine de l'axe X
@@ -202,6 +277,40 @@ void joypad::calibration(uint8_t const & pin)
     }
 }
 
+// **Définition de la fonction de démarrage du calibrage non bloquant**
+void joypad::demarrerCalibration()
+{
+    m_xOri = analogRead(A0) >> 1;
+    m_yOri = analogRead(A1) >> 1;
+
+    m_xMin = m_xOri;
+    m_yMin = m_yOri;
+    m_xMax = m_xOri;
+    m_yMax = m_yOri;
+
+    m_calibrationEnCours = true;
+}
+
+// **Définition de la fonction de suivi du calibrage non bloquant**
+bool joypad::suivreCalibration(uint8_t const & pin)
+{
+    if (!m_calibrationEnCours) return false;
+
+    int x = analogRead(A0) >> 1;
+    int y = analogRead(A1) >> 1;
+
+    m_xMax = x > m_xMax ? x : m_xMax;
+    m_yMax = y > m_yMax ? y : m_yMax;
+
+    m_xMin = x < m_xMin ? x : m_xMin;
+    m_yMin = y < m_yMin ? y : m_yMin;
+
+    // Le bouton 'pin' pressé arrête le calibrage
+    m_calibrationEnCours = digitalRead(pin);
+
+    return m_calibrationEnCours;
+}
+
 // **Définition de la fonction de lightCalibration**
 void joypad::lightCalibration()
 {
@@ -212,38 +321,62 @@ void joypad::lightCalibration()
 // **Définition de la fonction de lecture des axes**
 void joypad::getAxis(int8_t &x, int8_t &y)
 {
-    int16_t ax = analogRead(A0) >> 1; // Valeur lue sur l'axe X corrigée du LSB
-    int16_t ay = analogRead(A1) >> 1; // Valeur lue sur l'axe Y corrigée du LSB
+    int16_t ax, ay;
+    getAxis(ax, ay, 100);
+    x = ax;
+    y = ay;
+}
+
+// **Définition de la fonction de lecture des axes avec une amplitude donnée**
+void joypad::getAxis(int16_t &x, int16_t &y, int16_t amplitude)
+{
+    // Les valeurs de calibrage sont corrigées du LSB : elles sont ramenées à la pleine résolution
+    int16_t ax = analogRead(A0); // Valeur lue sur l'axe X
+    int16_t ay = analogRead(A1); // Valeur lue sur l'axe Y
 
-    if (ax < m_xOri)
+    if (ax < m_xOri << 1)
     {
-        x = map(ax, m_xMin, m_xOri, -100, 0); // Mappage de la valeur de l'axe X entre -100 et 0
+        x = map(ax, m_xMin << 1, m_xOri << 1, -amplitude, 0); // Mappage de la valeur de l'axe X entre -amplitude et 0
     }
     else
     {
-        x = map(ax, m_xOri, m_xMax, 0, 100); // Mappage de la valeur de l'axe X entre   0 et 100
+        x = map(ax, m_xOri << 1, m_xMax << 1, 0, amplitude); // Mappage de la valeur de l'axe X entre   0 et amplitude
     }
 
-    if (ay < m_yOri)
+    if (ay < m_yOri << 1)
     {
-        y = map(ay, m_yMin, m_yOri, -100, 0); // Mappage de la valeur de l'axe Y entre -100 et 0
+        y = map(ay, m_yMin << 1, m_yOri << 1, -amplitude, 0); // Mappage de la valeur de l'axe Y entre -amplitude et 0
     }
     else
     {
-        y = map(ay, m_yOri, m_yMax, 0, 100); // Mappage de la valeur de l'axe Y entre   0 et 100
+        y = map(ay, m_yOri << 1, m_yMax << 1, 0, amplitude); // Mappage de la valeur de l'axe Y entre   0 et amplitude
     }
+
+    x = constrain(x, -amplitude, amplitude);
+    y = constrain(y, -amplitude, amplitude);
 }
 
 // **Définition de la fonction de lecture de l'état de tous les boutons**
 uint8_t joypad::getButton()
 {
-    // Combine les broches des boutons A à K dans un masque binaire
-    uint8_t buttonMap = ~((PIND >> 2) | ((PINB << 6)));
+    // Combine les broches des boutons A à K dans un masque binaire, sans les autres broches du port B (CE de la radio)
+    uint8_t buttonMap = ~((PIND >> 2) | ((PINB << 6))) & maskBoutons;
 
     // Détecte les changements d'état par comparaison avec la lecture précédente
     m_changed = m_oldPressed ^ buttonMap;
     m_oldPressed = buttonMap;
 
+    // L'état stable n'est mis à jour qu'une fois les boutons immobiles depuis JOYPAD_ANTIREBOND ms
+    unsigned long maintenant = millis();
+    if (m_changed)
+    {
+        m_instantChangement = maintenant;
+    }
+    else if (maintenant - m_instantChangement >= JOYPAD_ANTIREBOND)
+    {
+        m_stable = buttonMap;
+    }
+
     return buttonMap;
 }
 
@@ -279,32 +412,55 @@ inline void joypad::check()
 
         if(changed() != 0 || xOld != x || yOld != y)
         {
-            for (unsigned char i = 0; i < 6; ++i)
-            {
-                Serial.print(F("Bouton "));
-                Serial.print((char)('A' + i));
-                Serial.print(F(" = "));
-                Serial.print((char)('0' + readButton(boutons, pinBoutonA + i)));
-                Serial.print('\n');
-            }
-            Serial.print('\n');
-            Serial.print(F("Bouton "));
-            Serial.print('K');
-            Serial.print(F(" = "));
-            Serial.print((char)('0' + readButton(boutons, pinBoutonK)));
-            Serial.print('\n');
-    
-            Serial.print('\n');
-            Serial.print(F("X = "));
-            Serial.print(x);
-            Serial.print(F(" Y = "));
-            Serial.println(y);
-            Serial.print('\n');
+            afficher(boutons, x, y);
     
             delay(100);
         }
     }
 }
 
+// **Définition de la fonction d'affichage de l'état des boutons et des axes**
+inline void joypad::afficher(uint8_t const & boutons, int8_t const & x, int8_t const & y) const
+{
+    for (unsigned char i = 0; i < 6; ++i)
+    {
+        Serial.print(F("Bouton "));
+        Serial.print((char)('A' + i));
+        Serial.print(F(" = "));
+        Serial.print((char)('0' + readButton(boutons, pinBoutonA + i)));
+        Serial.print('\n');
+    }
+    Serial.print('\n');
+    Serial.print(F("Bouton "));
+    Serial.print('K');
+    Serial.print(F(" = "));
+    Serial.print((char)('0' + readButton(boutons, pinBoutonK)));
+    Serial.print('\n');
+
+    Serial.print('\n');
+    Serial.print(F("X = "));
+    Serial.print(x);
+    Serial.print(F(" Y = "));
+    Serial.println(y);
+    Serial.print('\n');
+}
+
+// **Définition de la fonction d'affichage des valeurs de calibrage**
+inline void joypad::afficherCalibration() const
+{
+    Serial.print(F("X min/ori/max = "));
+    Serial.print(m_xMin);
+    Serial.print('/');
+    Serial.print(m_xOri);
+    Serial.print('/');
+    Serial.println(m_xMax);
+    Serial.print(F("Y min/ori/max = "));
+    Serial.print(m_yMin);
+    Serial.print('/');
+    Serial.print(m_yOri);
+    Serial.print('/');
+    Serial.println(m_yMax);
+}
+
 #endif
 
@@ -0,0 +1,302 @@
+/**
+ * @file latence.h
+ * @author Florent LERAY, Jérémy Lefort Besnard
+ * @date 2024-03-06
+ * @brief Définit les classes `histogramme` et `sondeLatence` pour mesurer la latence de la liaison radio.
+ *
+ * En mode sonde, la télécommande place un jeton dans les messages envoyés. Le bateau renvoie ce jeton dans
+ * la charge utile de l'acquittement, accompagné du délai entre la réception du message et l'application des
+ * PWM. La télécommande en déduit la latence aller-retour et une estimation de la latence aller (du message
+ * envoyé jusqu'aux moteurs pilotés), qu'elle accumule dans des histogrammes.
+ */
+
+#pragma once
+#ifndef LATENCE_h
+#define LATENCE_h
+
+#include "Arduino.h"
+#include "radioMessage.h"
+
+#define LATENCE_NB_CLASSES  12      ///< Nombre de classes des histogrammes (de 512 µs à plus de 0,5 s)
+#define LATENCE_DECALAGE     9      ///< La classe 0 regroupe les mesures inférieures à 2^9 µs
+#define SONDE_DELAI_MAX 250000UL    ///< Délai en microsecondes au-delà duquel un jeton est considéré perdu
+#define SONDE_RELANCE     1000UL    ///< Intervalle minimal en microsecondes entre deux relances du bateau
+
+/**
+ * @class histogramme
+ * @brief Histogramme à classes logarithmiques (puissances de deux) de durées en microsecondes.
+ */
+class histogramme
+{
+public:
+    inline histogramme() { effacer(); }
+    inline ~histogramme() {}
+
+    inline void ajouter(uint32_t duree);
+    inline void effacer();
+    inline uint32_t percentile(uint8_t pourcentage) const;
+    inline void afficher(const __FlashStringHelper * nom) const;
+
+private:
+    uint16_t m_classes[LATENCE_NB_CLASSES]; ///< Nombre de mesures par classe
+    uint16_t m_total;                       ///< Nombre total de mesures
+    uint32_t m_min;                         ///< Plus petite mesure
+    uint32_t m_max;                         ///< Plus grande mesure
+};
+
+/**
+ * @class sondeLatence
+ * @brief Suivi des jetons de mesure de latence en attente d'écho.
+ */
+class sondeLatence
+{
+public:
+    inline sondeLatence();
+    inline ~sondeLatence() {}
+
+    inline void activer(bool actif);
+    inline bool active() const { return m_active; }
+    inline bool attendEcho() const { return m_attente; }
+
+    inline uint8_t prochainJeton(uint32_t maintenant);
+    inline bool relancer(uint32_t maintenant);
+    inline void recevoirEcho(radioEcho const & echo, uint32_t maintenant);
+    inline void verifierDelai(uint32_t maintenant);
+    inline void abandonner();
+
+    inline void afficher() const;
+
+private:
+    bool     m_active;     ///< Mode sonde activé
+    bool     m_attente;    ///< Un jeton a été envoyé et attend son écho
+    uint8_t  m_jeton;      ///< Dernier jeton envoyé (jamais 0)
+    uint32_t m_depart;     ///< Instant d'envoi du dernier jeton en microsecondes
+    uint32_t m_relance;    ///< Instant de la dernière relance en microsecondes
+    uint16_t m_perdus;     ///< Nombre de jetons sans écho dans le délai SONDE_DELAI_MAX
+
+    histogramme m_allerRetour; ///< Latence aller-retour
+    histogramme m_aller;       ///< Latence aller estimée, jusqu'à l'application des PWM
+};
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ///////////////////////////// histogramme //////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Ajouter une mesure à l'histogramme
+ *
+ * La classe i regroupe les durées comprises entre 2^(i+8) et 2^(i+9) microsecondes, la première et la
+ * dernière classe recueillant aussi les valeurs hors bornes.
+ *
+ * @param duree Durée mesurée en microsecondes
+ */
+inline void histogramme::ajouter(uint32_t duree)
+{
+    uint8_t classe = 0;
+    for (uint32_t borne = duree >> LATENCE_DECALAGE; borne && classe < LATENCE_NB_CLASSES - 1; borne >>= 1) ++classe;
+
+    if (m_total == UINT16_MAX) return;
+
+    ++m_classes[classe];
+    ++m_total;
+    m_min = duree < m_min ? duree : m_min;
+    m_max = duree > m_max ? duree : m_max;
+}
+
+/**
+ * @brief Effacer toutes les mesures
+ */
+inline void histogramme::effacer()
+{
+    memset(m_classes, 0, sizeof(m_classes));
+    m_total = 0;
+    m_min = UINT32_MAX;
+    m_max = 0;
+}
+
+/**
+ * @brief Calculer un percentile de l'histogramme
+ *
+ * La valeur renvoyée est la borne haute de la classe contenant le percentile, limitée à la plus grande mesure.
+ *
+ * @param pourcentage Percentile recherché (entre 1 et 100)
+ * @return Borne haute du percentile en microsecondes, 0 si l'histogramme est vide
+ */
+inline uint32_t histogramme::percentile(uint8_t pourcentage) const
+{
+    if (!m_total) return 0;
+
+    uint32_t cible = ((uint32_t)m_total * pourcentage + 99) / 100;
+    uint32_t cumul = 0;
+
+    for (uint8_t i = 0; i < LATENCE_NB_CLASSES; ++i)
+    {
+        cumul += m_classes[i];
+        if (cumul >= cible)
+        {
+            uint32_t borne = 1UL << (i + LATENCE_DECALAGE);
+            return borne < m_max ? borne : m_max;
+        }
+    }
+    return m_max;
+}
+
+/**
+ * @brief Afficher le résumé de l'histogramme sur le port série
+ * @param nom Nom de l'histogramme, affiché en tête de ligne
+ */
+inline void histogramme::afficher(const __FlashStringHelper * nom) const
+{
+    Serial.print(nom);
+    Serial.print(F(" n="));
+    Serial.print(m_total);
+    if (m_total)
+    {
+        Serial.print(F(" min="));
+        Serial.print(m_min);
+        Serial.print(F(" p50<="));
+        Serial.print(percentile(50));
+        Serial.print(F(" p90<="));
+        Serial.print(percentile(90));
+        Serial.print(F(" p99<="));
+        Serial.print(percentile(99));
+        Serial.print(F(" max="));
+        Serial.print(m_max);
+        Serial.print(F(" us"));
+    }
+    Serial.println();
+}
+
+
+
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ///////////////////////////// sondeLatence /////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+// ////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Constructeur de la classe sondeLatence
+ */
+inline sondeLatence::sondeLatence()
+{
+    m_active = false;
+    m_attente = false;
+    m_jeton = 0;
+    m_depart = 0;
+    m_relance = 0;
+    m_perdus = 0;
+}
+
+/**
+ * @brief Activer ou désactiver le mode sonde
+ *
+ * L'activation efface les mesures précédentes.
+ *
+ * @param actif true pour activer le mode sonde, false pour le désactiver
+ */
+inline void sondeLatence::activer(bool actif)
+{
+    if (actif && !m_active)
+    {
+        m_allerRetour.effacer();
+        m_aller.effacer();
+        m_perdus = 0;
+    }
+    m_active = actif;
+    m_attente = false;
+}
+
+/**
+ * @brief Obtenir le jeton à placer dans le prochain message
+ *
+ * Un nouveau jeton n'est émis que si le mode sonde est actif et qu'aucun jeton n'attend son écho.
+ *
+ * @param maintenant Instant d'envoi du message en microsecondes
+ * @return Le jeton à placer dans le message, 0 si le message ne porte pas de jeton
+ */
+inline uint8_t sondeLatence::prochainJeton(uint32_t maintenant)
+{
+    if (!m_active || m_attente) return 0;
+
+    m_jeton = m_jeton == UINT8_MAX ? 1 : m_jeton + 1;
+    m_depart = maintenant;
+    m_relance = maintenant;
+    m_attente = true;
+    return m_jeton;
+}
+
+/**
+ * @brief Indiquer s'il faut relancer le bateau pour obtenir l'écho du jeton en attente
+ *
+ * L'écho n'est renvoyé que dans l'acquittement d'un message suivant. Les relances sont espacées d'au moins
+ * SONDE_RELANCE microsecondes pour ne pas saturer la FIFO de réception du bateau, ce qui fausserait la mesure.
+ *
+ * @param maintenant Instant courant en microsecondes
+ * @return true si un message de relance doit être envoyé maintenant, false sinon
+ */
+inline bool sondeLatence::relancer(uint32_t maintenant)
+{
+    if (!m_attente || maintenant - m_relance < SONDE_RELANCE) return false;
+
+    m_relance = maintenant;
+    return true;
+}
+
+/**
+ * @brief Traiter un écho reçu dans un acquittement
+ *
+ * Les échos dont le jeton ne correspond pas au jeton en attente sont ignorés.
+ *
+ * @param echo Écho renvoyé par le bateau
+ * @param maintenant Instant de réception de l'écho en microsecondes
+ */
+inline void sondeLatence::recevoirEcho(radioEcho const & echo, uint32_t maintenant)
+{
+    if (!m_attente || echo.jeton != m_jeton) return;
+
+    uint32_t allerRetour = maintenant - m_depart;
+    uint32_t delai = echo.delai < allerRetour ? echo.delai : allerRetour;
+
+    m_allerRetour.ajouter(allerRetour);
+    m_aller.ajouter((allerRetour - delai) / 2 + delai);
+    m_attente = false;
+}
+
+/**
+ * @brief Abandonner le jeton en attente si son écho n'est pas revenu dans le délai SONDE_DELAI_MAX
+ * @param maintenant Instant courant en microsecondes
+ */
+inline void sondeLatence::verifierDelai(uint32_t maintenant)
+{
+    if (maintenant - m_depart > SONDE_DELAI_MAX) abandonner();
+}
+
+/**
+ * @brief Abandonner le jeton en attente, par exemple si son message n'a pas été acquitté
+ */
+inline void sondeLatence::abandonner()
+{
+    if (m_attente)
+    {
+        ++m_perdus;
+        m_attente = false;
+    }
+}
+
+/**
+ * @brief Afficher les histogrammes de latence sur le port série
+ */
+inline void sondeLatence::afficher() const
+{
+    m_allerRetour.afficher(F("Aller-retour"));
+    m_aller.afficher(F("Aller estime"));
+    Serial.print(F("Jetons perdus = "));
+    Serial.println(m_perdus);
+}
+
+#endif
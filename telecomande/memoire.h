@@ -0,0 +1,78 @@
+/**
+ * @file memoire.h
+ * @author Florent LERAY, Jérémy Lefort Besnard
+ * @date 2024-03-06
+ * @brief Définit les fonctions de mesure de la mémoire vive libre.
+ *
+ * Au démarrage, avant l'initialisation des variables globales, la mémoire comprise entre la fin du tas et
+ * le sommet de la pile est remplie d'un motif connu (peinture de pile). La pile qui grandit efface ce motif :
+ * la quantité de motif encore intacte donne la marge minimale de mémoire libre atteinte depuis le démarrage.
+ */
+
+#pragma once
+#ifndef MEMOIRE_h
+#define MEMOIRE_h
+
+#include "Arduino.h"
+
+#define MEMOIRE_MOTIF 0xC5 ///< Motif écrit dans la mémoire libre au démarrage
+
+extern uint8_t   __heap_start; ///< Fin des variables globales, défini par l'éditeur de liens
+extern uint8_t * __brkval;     ///< Fin du tas, défini par malloc (0 si le tas n'a jamais été utilisé)
+
+/**
+ * @brief Peindre la mémoire libre avec le motif MEMOIRE_MOTIF
+ *
+ * Cette fonction est placée dans la section `.init3` : elle est exécutée automatiquement au démarrage, une
+ * fois le pointeur de pile initialisé et avant l'appel de `main()`. Elle ne doit donc jamais être appelée.
+ */
+void peindreMemoire() __attribute__((naked, used, section(".init3")));
+void peindreMemoire()
+{
+    for (uint8_t * p = &__heap_start; p < (uint8_t *)SP; ++p) *p = MEMOIRE_MOTIF;
+}
+
+/**
+ * @brief Adresse de la fin du tas
+ */
+inline uint8_t * finDuTas()
+{
+    return __brkval ? __brkval : &__heap_start;
+}
+
+/**
+ * @brief Mémoire libre actuelle entre la fin du tas et le sommet de la pile
+ * @return Nombre d'octets libres
+ */
+inline uint16_t memoireLibre()
+{
+    return (uint8_t *)SP - finDuTas();
+}
+
+/**
+ * @brief Mémoire libre minimale atteinte depuis le démarrage
+ *
+ * Cette fonction compte les octets du motif encore intacts au-dessus de la fin du tas.
+ * @return Nombre d'octets jamais utilisés par la pile
+ */
+inline uint16_t memoireLibreMin()
+{
+    uint8_t * p = finDuTas();
+    uint8_t * sommet = (uint8_t *)SP;
+    while (p < sommet && *p == MEMOIRE_MOTIF) ++p;
+
+    return p - finDuTas();
+}
+
+/**
+ * @brief Afficher la mémoire libre actuelle et minimale sur le port série
+ */
+inline void afficherMemoire()
+{
+    Serial.print(F("RAM libre = "));
+    Serial.print(memoireLibre());
+    Serial.print(F(" min = "));
+    Serial.println(memoireLibreMin());
+}
+
+#endif
@@ -17,8 +17,12 @@
 #include "joypad.h"       // Inclure la bibliothèque joystick
 #include "radioMessage.h" // Inclure la définition de la structure du message radio
 #include "reboot.h"       // Inclure la fonction de redémarrage
+#include "console.h"      // Inclure la console de commandes série
+#include "latence.h"      // Inclure la sonde de mesure de latence
+#include "emission.h"     // Inclure la file d'émission radio non bloquante
+#include "memoire.h"      // Inclure la mesure de la mémoire vive libre
 
-void joystickToMotors(int x, int y, int *left, int *right);
+void joystickToMotors(int16_t x, int16_t y, int16_t *left, int16_t *right);
 
 /**
  * @brief Broche CE (Chip Enable) connectée à l'émetteur-récepteur radio nRF24L01
@@ -51,7 +55,7 @@ radioMessage msg;
 uint8_t address[][6] = { "1NODE", "2NODE" };
 
 /**
- * @brief Stocke le masque binaire des boutons pressés
+ * @brief Stocke le masque binaire des boutons pressés depuis le dernier envoi
  */
 uint8_t boutons;
 
@@ -60,6 +64,31 @@ uint8_t boutons;
  */
 uint8_t radioPowerLevel = RF24_PA_LOW;
 
+/**
+ * @brief Console de commandes série pour le diagnostic
+ */
+console terminal;
+
+/**
+ * @brief File d'émission radio non bloquante
+ */
+emetteur emission(radio);
+
+/**
+ * @brief Période d'envoi des messages radio en millisecondes
+ */
+uint16_t periodeEnvoi = 200;
+
+/**
+ * @brief Instant du dernier envoi de message radio en millisecondes
+ */
+unsigned long dernierEnvoi = 0;
+
+/**
+ * @brief Sonde de mesure de la latence de la liaison radio
+ */
+sondeLatence sonde;
+
 
 /**
  * @brief Fonction de configuration
@@ -83,11 +112,15 @@ void setup()
   // Set the PA Level low to try preventing power supply related problems
   // because these examples are likely run with nodes in close proximity to
   // each other.
-  radio.setPALevel(RF24_PA_LOW);  // RF24_PA_MAX is default.
+  radio.setPALevel(radioPowerLevel);  // RF24_PA_MAX is default.
 
   // save on transmission time by setting the radio to only transmit the
   // number of bytes we need to transmit a float
-  radio.setPayloadSize(sizeof(msg));  // float datatype occupies 4 bytes
+  radio.setPayloadSize(sizeof(radioTrame));  // la trame codée occupe TRAME_TAILLE octets
+
+  // Les échos de la sonde de latence sont renvoyés par le bateau dans la charge utile des acquittements
+  radio.enableDynamicPayloads();
+  radio.enableAckPayload();
 
   // set the TX address of the RX node into the TX pipe
   radio.openWritingPipe(address[0]);  // always uses pipe 0
@@ -99,91 +132,167 @@ void setup()
 
   manette.lightCalibration();
   Serial.println(F("Setup finish"));
+  afficherMemoire();
 }
 
 /**
  * @brief Fonction de boucle
  *
- * Cette fonction lit en permanence les entrées du joystick, traite les pressions sur les boutons, prépare et envoie des messages radio,
- * et gère les commandes d'étalonnage, de réinitialisation et de redémarrage.
+ * Cette fonction surveille en permanence l'émission radio et la console. Toutes les `periodeEnvoi` millisecondes,
+ * elle lit les entrées du joystick, traite les pressions sur les boutons, prépare et envoie un message radio,
+ * et gère les commandes d'étalonnage, de réinitialisation et de redémarrage. Aucun passage n'attend la radio.
  */
 void loop()
 {    
-	int8_t x = 0;
-	int8_t y = 0;
-	
+	int16_t x = 0;
+	int16_t y = 0;
+	radioTrame trame;
+
     /**
-     * @brief Lit les valeurs des axes du joystick et les stocke dans la structure du message
+     * @brief Traite les acquittements et les échecs du message en vol
      */
-    manette.getAxis(x, y);
+    uint8_t evenements = emission.poll();
+    if (evenements & EMISSION_OK)
+    {
+      lireEchos();
+    }
+    if (evenements & EMISSION_ECHEC)
+    {
+      if (emission.marque()) sonde.abandonner(); // La trame perdue portait le jeton de la sonde
+      Serial.println(F("msg not send"));
+    }
+
+    /**
+     * @brief Traite au plus une commande de la console sans bloquer la boucle
+     */
+    if (terminal.poll())
+    {
+      traiterCommande();
+      terminal.effacer();
+    }
+
+    /**
+     * @brief En mode sonde, relance le bateau avec un message sans jeton jusqu'au retour de l'écho,
+     * un seul message en vol et au plus un toutes les SONDE_RELANCE microsecondes
+     */
+    sonde.verifierDelai(micros());
+    if (!emission.occupe() && sonde.relancer(micros()))
+    {
+      radioMessage relance = msg;
+      relance.jeton = 0;
+      encoder(relance, trame);
+      emission.envoyer(&trame, sizeof(trame));
+    }
+
+    /**
+     * @brief Poursuit un calibrage en cours à chaque passage, pour ne manquer aucune extrémité des axes
+     */
+    manette.suivreCalibration(pinBoutonA);
 
     /**
-     * @brief Lit le masque binaire des boutons pressés
+     * @brief Lit les boutons à chaque passage pour l'anti-rebond, et mémorise les appuis jusqu'au prochain envoi
      */
-    boutons = manette.getButton();
+    manette.getButton();
+    boutons |= manette.stable();
+
+    if (millis() - dernierEnvoi < periodeEnvoi) return;
+    dernierEnvoi = millis();
+	
+    /**
+     * @brief Lit les valeurs des axes du joystick et les stocke dans la structure du message
+     */
+    manette.getAxis(x, y, RADIO_VITESSE_MAX);
+
+    msg.boutons = boutons;
 
     joystickToMotors(x, y, &msg.gauche, &msg.droit);
 
+    /**
+     * @brief Pendant un calibrage, le bateau reste à l'arrêt
+     */
+    if (manette.calibrationEnCours())
+    {
+        msg.gauche = 0;
+        msg.droit = 0;
+        boutons = 0;
+    }
+
     /**
      * @brief Traite les événements de pression sur les boutons en fonction de leur position binaire
      */
     if (boutons & 0b00000001)
     {
-        msg.gauche = 100;
-        msg.droit = -100;
-        Serial.println("Bouton A");
+        msg.gauche = RADIO_VITESSE_MAX;
+        msg.droit = -RADIO_VITESSE_MAX;
+        Serial.println(F("Bouton A"));
     }
     if (boutons & 0b00000010)
     {
-        msg.gauche = -100;
-        msg.droit = 100;
-        Serial.println("Bouton B");
+        msg.gauche = -RADIO_VITESSE_MAX;
+        msg.droit = RADIO_VITESSE_MAX;
+        Serial.println(F("Bouton B"));
     }
     if (boutons & 0b00000100)
     {
-        manette.calibration(pinBoutonA);
-        Serial.println("Bouton C");
+        manette.demarrerCalibration();
+        Serial.println(F("Bouton C"));
     }
     if (boutons & 0b00001000)
     {
         //TODO
-        Serial.println("Bouton D");
+        Serial.println(F("Bouton D"));
     }
     if (boutons & 0b00010000)
     {
-        Serial.println("Bouton E");
+        Serial.println(F("Bouton E"));
         msg.cmd = radioCmd::RESET;
     }
     if (boutons & 0b00100000)
     {
-        Serial.println("Bouton F");
+        Serial.println(F("Bouton F"));
         reboot();
     }
 
-    assignCheck(msg);
+    // Les appuis mémorisés sont consommés par cet envoi
+    boutons = 0;
+
+    msg.jeton = sonde.prochainJeton(micros());
+    encoder(msg, trame);
     /**
-     * @brief Evoi le message radio au bateau
+     * @brief Evoi la trame radio au bateau, en remplaçant la trame précédente si elle attend encore son émission
      */
-    if (!radio.write(&msg, sizeof(msg)))
-    {
-      Serial.println(F("msg not send"));
-    }
-    delay(200);
+    emission.envoyer(&trame, sizeof(trame), msg.jeton != 0);
 }
 
 
+/**
+ * @brief Lit les charges utiles d'acquittement reçues et transmet les échos à la sonde de latence
+ */
+void lireEchos()
+{
+  uint32_t maintenant = micros();
+  radioEcho echo;
+
+  while (radio.available())
+  {
+    uint8_t bytes = radio.getDynamicPayloadSize();
+    radio.read(&echo, bytes < sizeof(echo) ? bytes : sizeof(echo));
+    if (bytes == sizeof(echo)) sonde.recevoirEcho(echo, maintenant);
+  }
+}
+
 /**
  * @brief Convertit les valeurs X et Y du joystick en valeurs pour les moteurs gauche et droit.
  *
  * Cette fonction utilise des fonctions trigonométriques pour calculer la direction et la magnitude du mouvement du joystick, 
  * puis les convertit en valeurs pour les moteurs gauche et droit.
  *
- * @param x Valeur X du joystick (comprise entre -100 et +100)
- * @param y Valeur Y du joystick (comprise entre -100 et +100)
+ * @param x Valeur X du joystick (comprise entre -RADIO_VITESSE_MAX et +RADIO_VITESSE_MAX)
+ * @param y Valeur Y du joystick (comprise entre -RADIO_VITESSE_MAX et +RADIO_VITESSE_MAX)
  * @param left Pointeur vers la variable qui stockera la valeur du moteur gauche
  * @param right Pointeur vers la variable qui stockera la valeur du moteur droit
  */
-void joystickToMotors(int x, int y, char *left, char *right)
+void joystickToMotors(int16_t x, int16_t y, int16_t *left, int16_t *right)
 {
     // Calcul de l'angle du joystick
     float angle = atan2(y, x) * 180 / M_PI;
@@ -192,6 +301,84 @@ void joystickToMotors(int x, int y, char *left, char *right)
     float magnitude = sqrt(pow(x, 2) + pow(y, 2));
 
     // Conversion de l'angle et de la magnitude en valeurs pour les moteurs
-    *left  = (char)(magnitude * cos(angle + 45));
-    *right = (char)(magnitude * sin(angle + 45));
-}
\ No newline at end of file
+    *left  = constrain((int16_t)(magnitude * cos(angle + 45)), -RADIO_VITESSE_MAX, RADIO_VITESSE_MAX);
+    *right = constrain((int16_t)(magnitude * sin(angle + 45)), -RADIO_VITESSE_MAX, RADIO_VITESSE_MAX);
+}
+
+/**
+ * @brief Exécute la commande reçue sur la console série
+ *
+ * Commandes disponibles :
+ * - `AXES`     : affiche l'état des axes et des boutons
+ * - `STAT`     : affiche les compteurs d'envoi radio
+ * - `PARAM`    : affiche la puissance radio, la période d'envoi et le calibrage du joystick
+ * - `PA n`     : change la puissance radio (0 = min, 1 = low, 2 = high, 3 = max)
+ * - `PERIODE n`: change la période d'envoi des messages en millisecondes
+ * - `CAL`      : démarre un calibrage du joystick, terminé par le bouton A
+ * - `SONDE n`  : active (1) ou désactive (0) le mode sonde de latence
+ * - `LATENCE`  : affiche les histogrammes de latence
+ * - `MEM`      : affiche la mémoire vive libre actuelle et minimale
+ */
+void traiterCommande()
+{
+  if (terminal.commande(PSTR("AXES")))
+  {
+    int8_t x = 0;
+    int8_t y = 0;
+    manette.getAxis(x, y);
+    manette.afficher(manette.stable(), x, y);
+  }
+  else if (terminal.commande(PSTR("STAT")))
+  {
+    Serial.print(F("Envois = "));
+    Serial.print(emission.acquittes());
+    Serial.print(F(" Echecs = "));
+    Serial.print(emission.echecs());
+    Serial.print(F(" Remplaces = "));
+    Serial.print(emission.remplaces());
+    Serial.print(F(" Expires = "));
+    Serial.println(emission.expires());
+  }
+  else if (terminal.commande(PSTR("PARAM")))
+  {
+    Serial.print(F("RF24_PA = "));
+    Serial.println(radioPowerLevel);
+    Serial.print(F("Periode = "));
+    Serial.println(periodeEnvoi);
+    manette.afficherCalibration();
+  }
+  else if (terminal.commande(PSTR("PERIODE")))
+  {
+    periodeEnvoi = constrain(terminal.argumentEntier(periodeEnvoi), 1, 1000);
+  }
+  else if (terminal.commande(PSTR("PA")))
+  {
+    radioPowerLevel = constrain(terminal.argumentEntier(radioPowerLevel), RF24_PA_MIN, RF24_PA_MAX);
+    radio.setPALevel(radioPowerLevel);
+    Serial.print(F("RF24_PA change"));
+    Serial.println(radioPowerLevel);
+  }
+  else if (terminal.commande(PSTR("CAL")))
+  {
+    manette.demarrerCalibration();
+    Serial.println(F("Calibrage : bouton A pour terminer"));
+  }
+  else if (terminal.commande(PSTR("SONDE")))
+  {
+    sonde.activer(terminal.argumentEntier(!sonde.active()));
+    Serial.print(F("Sonde = "));
+    Serial.println(sonde.active());
+  }
+  else if (terminal.commande(PSTR("LATENCE")))
+  {
+    sonde.afficher();
+  }
+  else if (terminal.commande(PSTR("MEM")))
+  {
+    afficherMemoire();
+  }
+  else
+  {
+    Serial.println(F("Commandes : AXES STAT PARAM PA n PERIODE n CAL SONDE n LATENCE MEM"));
+  }
+}